@@ -1,11 +1,31 @@
+#pragma once
+
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <cstdint>
+#include <functional>
 #include <initializer_list>
 #include <list>
 #include <memory>
 #include <iterator>
 #include <exception>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
 #include <utility>
+#include <vector>
+
+#ifdef MY_VECTOR_TRACE
+#include "my_vector_trace.h"
+#define MY_VECTOR_RECORD_FOR(owner, code, a, b) \
+    my_vector_trace::record((owner)._trace_id, my_vector_trace::code, (a), (b))
+#else
+#define MY_VECTOR_RECORD_FOR(owner, code, a, b)
+#endif
+#define MY_VECTOR_RECORD(code, a, b) MY_VECTOR_RECORD_FOR(*this, code, a, b)
 
 template <class T>
 class my_vector;
@@ -13,6 +33,9 @@ class my_vector;
 template <class T>
 class vector_iterator;
 
+template <class T>
+class vector_view;
+
 template <class T>
 class const_vector_iterator: public std::iterator<
     std::random_access_iterator_tag, T> {
@@ -21,6 +44,11 @@ class const_vector_iterator: public std::iterator<
     typename std::list<T>::const_iterator inner_iterator;
     typename std::list<std::list<T>>::const_iterator outer_iterator;
     const std::list<T>* current_element_for_inner;
+#ifdef MY_VECTOR_TRACE
+    // index the iterator had when first incremented, traced as the start
+    // of the loop once it runs into end()
+    std::size_t trace_from = static_cast<std::size_t>(-1);
+#endif
 
  public:
     friend class my_vector<T>;
@@ -49,15 +77,25 @@ class const_vector_iterator: public std::iterator<
         , inner_iterator(other.inner_iterator)
         , outer_iterator(other.outer_iterator)
         , current_element_for_inner(other.current_element_for_inner)
+#ifdef MY_VECTOR_TRACE
+        , trace_from(other.trace_from)
+#endif
     {}
 
     const_vector_iterator& operator++() {
+#ifdef MY_VECTOR_TRACE
+        if (trace_from == static_cast<std::size_t>(-1)) {
+            trace_from = (*associated_vector).index_by_iterator(*this);
+        }
+#endif
         ++inner_iterator;
         if (inner_iterator == (*current_element_for_inner).end()) {
             ++outer_iterator;
             if (outer_iterator != (*associated_vector)._data.end()) {
                 current_element_for_inner = &(*outer_iterator);
                 inner_iterator = (*outer_iterator).begin();
+            } else {
+                MY_VECTOR_RECORD_FOR(*associated_vector, iterate, trace_from, (*associated_vector)._size);
             }
         }
         return (*this);        
@@ -95,20 +133,27 @@ class const_vector_iterator: public std::iterator<
     }
 
     const_vector_iterator operator+=(size_t shift) {
+        if (outer_iterator == (*associated_vector)._data.end()) {
+            return (*this);
+        }
         while (shift != 0 && inner_iterator != (*current_element_for_inner).end()) {
             ++inner_iterator;
             --shift;
         }
-        if (inner_iterator == (*current_element_for_inner).end()) {
+        while (inner_iterator == (*current_element_for_inner).end() &&
+            std::next(outer_iterator) != (*associated_vector)._data.end()) {
             ++outer_iterator;
-            inner_iterator = (*outer_iterator).begin();
             current_element_for_inner = &(*outer_iterator);
+            if ((*outer_iterator).size() <= shift) {
+                shift -= (*outer_iterator).size();
+                inner_iterator = (*outer_iterator).end();
+            } else {
+                inner_iterator = (*outer_iterator).begin();
+            }
         }
-        while ((*outer_iterator).size() < shift) {
-            shift -= (*outer_iterator).size();
+        if (inner_iterator == (*current_element_for_inner).end()) {
             ++outer_iterator;
-            inner_iterator = (*outer_iterator).begin();
-            current_element_for_inner = &(*outer_iterator);    
+            return (*this);
         }
         while (shift != 0) {
             ++inner_iterator;
@@ -173,8 +218,8 @@ class const_vector_iterator: public std::iterator<
             ++dist1;
         }
         while (tmp.outer_iterator != (*associated_vector)._data.begin()) {
-            dist1 += (*tmp.outer_iterator).size();
             --tmp.outer_iterator;
+            dist1 += (*tmp.outer_iterator).size();
         }
 
         const_vector_iterator tmp2(other);
@@ -184,8 +229,8 @@ class const_vector_iterator: public std::iterator<
             ++dist2;
         }
         while (tmp2.outer_iterator != (*associated_vector)._data.begin()) {
-            dist2 += (*tmp2.outer_iterator).size();
             --tmp2.outer_iterator;
+            dist2 += (*tmp2.outer_iterator).size();
         }
 
         return dist1 - dist2;
@@ -223,6 +268,9 @@ class vector_iterator: public std::iterator<
     typename std::list<T>::iterator inner_iterator;
     typename std::list<std::list<T>>::iterator outer_iterator;
     std::list<T>* current_element_for_inner;
+#ifdef MY_VECTOR_TRACE
+    std::size_t trace_from = static_cast<std::size_t>(-1);
+#endif
 
  public:
     friend class my_vector<T>;
@@ -251,6 +299,9 @@ class vector_iterator: public std::iterator<
         inner_iterator = other.inner_iterator;
         outer_iterator = other.outer_iterator;
         current_element_for_inner = other.current_element_for_inner;
+#ifdef MY_VECTOR_TRACE
+        trace_from = other.trace_from;
+#endif
         return (*this);
     }
 
@@ -259,16 +310,26 @@ class vector_iterator: public std::iterator<
         inner_iterator = other.inner_iterator;
         outer_iterator = other.outer_iterator;
         current_element_for_inner = other.current_element_for_inner;
+#ifdef MY_VECTOR_TRACE
+        trace_from = other.trace_from;
+#endif
         return (*this);
     }
 
     vector_iterator& operator++() {
+#ifdef MY_VECTOR_TRACE
+        if (trace_from == static_cast<std::size_t>(-1)) {
+            trace_from = (*associated_vector).index_by_iterator(*this);
+        }
+#endif
         ++inner_iterator;
         if (inner_iterator == (*current_element_for_inner).end()) {
             ++outer_iterator;
             if (outer_iterator != (*associated_vector)._data.end()) {
                 current_element_for_inner = &(*outer_iterator);
                 inner_iterator = (*outer_iterator).begin();
+            } else {
+                MY_VECTOR_RECORD_FOR(*associated_vector, iterate, trace_from, (*associated_vector)._size);
             }
         }
         return (*this);        
@@ -305,20 +366,27 @@ class vector_iterator: public std::iterator<
     }
 
     vector_iterator operator+=(size_t shift) {
+        if (outer_iterator == (*associated_vector)._data.end()) {
+            return (*this);
+        }
         while (shift != 0 && inner_iterator != (*current_element_for_inner).end()) {
             ++inner_iterator;
             --shift;
         }
-        if (inner_iterator == (*current_element_for_inner).end()) {
+        while (inner_iterator == (*current_element_for_inner).end() &&
+            std::next(outer_iterator) != (*associated_vector)._data.end()) {
             ++outer_iterator;
-            inner_iterator = (*outer_iterator).begin();
             current_element_for_inner = &(*outer_iterator);
+            if ((*outer_iterator).size() <= shift) {
+                shift -= (*outer_iterator).size();
+                inner_iterator = (*outer_iterator).end();
+            } else {
+                inner_iterator = (*outer_iterator).begin();
+            }
         }
-        while ((*outer_iterator).size() < shift) {
-            shift -= (*outer_iterator).size();
+        if (inner_iterator == (*current_element_for_inner).end()) {
             ++outer_iterator;
-            inner_iterator = (*outer_iterator).begin();
-            current_element_for_inner = &(*outer_iterator);    
+            return (*this);
         }
         while (shift != 0) {
             ++inner_iterator;
@@ -383,8 +451,8 @@ class vector_iterator: public std::iterator<
             ++dist1;
         }
         while (tmp.outer_iterator != (*associated_vector)._data.begin()) {
-            dist1 += (*tmp.outer_iterator).size();
             --tmp.outer_iterator;
+            dist1 += (*tmp.outer_iterator).size();
         }
 
         vector_iterator tmp2(other);
@@ -394,8 +462,8 @@ class vector_iterator: public std::iterator<
             ++dist2;
         }
         while (tmp2.outer_iterator != (*associated_vector)._data.begin()) {
-            dist2 += (*tmp2.outer_iterator).size();
             --tmp2.outer_iterator;
+            dist2 += (*tmp2.outer_iterator).size();
         }
 
         return dist1 - dist2;
@@ -410,6 +478,7 @@ class vector_iterator: public std::iterator<
     }
 
     T& operator* () {
+        associated_vector->touch_bucket(current_element_for_inner);
         return *inner_iterator;
     }
 
@@ -437,63 +506,270 @@ class my_vector {
     std::list<std::list<T>> _data;
     size_t _size;
     static const size_t _MAX_FOR_ONE_LIST = 64;
+    static const size_t _PARALLEL_COPY_THRESHOLD = 1 << 16;
+
+    // a resolved position: the element, its bucket and where the bucket starts
+    struct cursor {
+        typename std::list<std::list<T>>::iterator outer;
+        typename std::list<T>::iterator inner;
+        size_t start;
+        size_t pos;
+    };
+
+    // finger: the last position resolved by index on a non-const path, so
+    // that nearby lookups resume from it instead of walking from the front;
+    // const lookups never write it and may run concurrently
+    cursor _finger;
+    bool _finger_valid = false;
+
+    // deferred mode replaces full rebuilds with local split/merge of the
+    // touched bucket; rebalance_step() tidies the rest bit by bit
+    bool _deferred_rebalance = false;
+    size_t _rebalance_cursor = 0;
+
+    // size promised by reserve(); until it is reached buckets are only
+    // fixed up locally, so a bulk load never rebuilds. Bucket sizes follow
+    // _size regardless, so an unreached reservation costs lookups nothing
+    size_t _capacity = 0;
+
+    // adaptive bucket sizing: target bucket size is sqrt(n) * _bucket_scale;
+    // const reads only bump a relaxed atomic, which the next non-const
+    // operation folds into _reads before the scale is updated
+    static const size_t _SAMPLE_WINDOW = 1024;
+    double _min_bucket_scale = 0.5;
+    double _max_bucket_scale = 2.0;
+    double _bucket_scale = 1.0;
+    double _read_share = 0.5;
+    size_t _reads = 0;
+    size_t _writes = 0;
+    mutable std::atomic<size_t> _const_reads{0};
+
+    // per-bucket hash cache: (hash, multiplier^length) keyed by bucket
+    // address, an entry is dropped whenever its bucket may change; it is
+    // filled only on non-const paths, so const hash() calls may run together
+    static const uint64_t _HASH_MULTIPLIER = 0x100000001b3ULL;
+    std::unordered_map<const std::list<T>*, std::pair<uint64_t, uint64_t>> _bucket_hashes;
+    size_t (*_element_hash)(const T&) = nullptr;
+
+#ifdef MY_VECTOR_TRACE
+    uint64_t _trace_id = my_vector_trace::next_id();
+#endif
     friend class vector_iterator<T>;
     friend class const_vector_iterator<T>;
+    friend class vector_view<T>;
+
+    // relinks every element into balanced_bucket_count() buckets of equal
+    // size (give or take one); nodes are spliced, not copied
+    void rebuild() noexcept {
+        drop_finger();
+        touch_all();
+        MY_VECTOR_RECORD(rebalance, _size, 0);
+        std::list<T> all;
+        for (auto& bucket : _data) {
+            all.splice(all.end(), bucket);
+        }
+        _data.clear();
+        size_t buckets = balanced_bucket_count();
+        for (size_t i = 0; i < buckets; ++i) {
+            _data.emplace_back(std::list<T>());
+            auto last = all.begin();
+            std::advance(last, _size / buckets + (i < _size % buckets ? 1 : 0));
+            _data.back().splice(_data.back().end(), all, all.begin(), last);
+        }
+    }
 
     void rebalance() noexcept {
+        if (_data.empty()) {
+            return;
+        }
         if (_size <= _MAX_FOR_ONE_LIST) {
-            if (_data.size() == 1) {
-                return;
-            } else {
-                auto it = _data.begin();
-                ++it;
-                for (; it != _data.end(); ++it) {
-                    auto cur_list = *it;
-                    for (auto& el : cur_list) {
-                        (*_data.begin()).push_back(el);
-                    }
-                }
-                while (_data.size() > 1) {
-                    _data.pop_back();
-                }
+            if (_data.size() != 1) {
+                rebuild();
             }
-        } else {
-            size_t max_bucket = (*_data.begin()).size();
-            size_t min_bucket = (*_data.begin()).size();
-            for (const auto& el : _data) {
-                max_bucket = std::max(max_bucket, el.size());
-                min_bucket = std::min(min_bucket, el.size());
+            return;
+        }
+        size_t max_bucket = (*_data.begin()).size();
+        size_t min_bucket = (*_data.begin()).size();
+        for (const auto& el : _data) {
+            max_bucket = std::max(max_bucket, el.size());
+            min_bucket = std::min(min_bucket, el.size());
+        }
+        size_t target = target_bucket_size();
+        size_t average = _size / _data.size();
+        if (_data.size() == 1 || max_bucket > 2 * min_bucket ||
+            2 * average < target || average > 2 * target) {
+            rebuild();
+        }
+    }
+
+    size_t target_bucket_size() const noexcept {
+        double target = floor(sqrt(_size)) * _bucket_scale;
+        return std::max<size_t>(1, static_cast<size_t>(target));
+    }
+
+    // every _SAMPLE_WINDOW index lookups and positional mutations the
+    // read share is folded into a moving average, and the bucket scale
+    // slides geometrically between its bounds: reads pull towards the
+    // upper bound (few large buckets), writes towards the lower one
+    void adapt_bucket_scale() noexcept {
+        _reads += _const_reads.exchange(0, std::memory_order_relaxed);
+        if (_reads + _writes < _SAMPLE_WINDOW) {
+            return;
+        }
+        double share = static_cast<double>(_reads) / (_reads + _writes);
+        _read_share = 0.75 * _read_share + 0.25 * share;
+        _bucket_scale = _min_bucket_scale * pow(_max_bucket_scale / _min_bucket_scale, _read_share);
+        _reads = 0;
+        _writes = 0;
+    }
+
+    void note_read() noexcept {
+        ++_reads;
+        adapt_bucket_scale();
+    }
+
+    void note_const_read() const noexcept {
+        _const_reads.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void note_write() noexcept {
+        ++_writes;
+        adapt_bucket_scale();
+    }
+
+    // libstdc++-like estimate: two links, then the value at its alignment
+    template <class U>
+    static size_t list_node_bytes() noexcept {
+        size_t align = std::max(alignof(U), alignof(void*));
+        return (2 * sizeof(void*) + sizeof(U) + align - 1) / align * align;
+    }
+
+    // runs f(0), ..., f(count - 1) spread over the hardware threads,
+    // rethrowing the first exception thrown by any of the calls
+    template <class Function>
+    static void parallel_for(size_t count, Function f) {
+        size_t workers = std::max<size_t>(1, std::thread::hardware_concurrency());
+        workers = std::min(workers, count);
+        if (workers <= 1) {
+            for (size_t i = 0; i < count; ++i) {
+                f(i);
             }
-            if (_data.size() == 1 || max_bucket > 2 * min_bucket) {
-                size_t bucket_size = floor(sqrt(_size));
-                std::list<T> buffer;
-                for (const auto& outer : _data) {
-                    for (const auto& inner : outer) {
-                        buffer.push_back(inner);
-                    }
-                }
-                _data.clear();
-                size_t currently_added = 0;
-                size_t bigger_buckets = _size % bucket_size;
-                for (const auto& el : buffer) {
-                    if (currently_added == 0) {
-                        _data.emplace_back(std::list<T>());
-                    }
-                    _data.back().push_back(el);
-                    if (bigger_buckets > 0) {
-                        if (currently_added == bucket_size + 1) {
-                            currently_added = 0;
-                            --bigger_buckets;
-                        } else {
-                            ++currently_added;
-                        }
-                    } else {
-                        currently_added = (currently_added + 1) % bucket_size;
+            return;
+        }
+        std::vector<std::exception_ptr> errors(workers);
+        std::vector<std::thread> threads;
+        for (size_t w = 0; w < workers; ++w) {
+            threads.emplace_back([&, w]() {
+                try {
+                    for (size_t i = w; i < count; i += workers) {
+                        f(i);
                     }
+                } catch (...) {
+                    errors[w] = std::current_exception();
                 }
-                buffer.clear();
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        for (auto& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+
+    using outer_iterator_t = typename std::list<std::list<T>>::iterator;
+
+    void rebalance_local(outer_iterator_t touched) {
+        rebalance_local(touched, target_bucket_size() / 2);
+    }
+
+    // splits an oversized bucket in halves or folds one below min_size (or
+    // empty) into its smaller neighbour, never touching more than two
+    // buckets
+    void rebalance_local(outer_iterator_t touched, size_t min_size) {
+        drop_finger();
+        touch_bucket(&(*touched));
+        size_t limit = std::max<size_t>(2 * target_bucket_size(), size_t(_MAX_FOR_ONE_LIST));
+        if (((*touched).empty() || (*touched).size() < min_size) && _data.size() > 1) {
+            auto neighbour = touched;
+            if (touched == _data.begin()) {
+                ++neighbour;
+            } else if (std::next(touched) == _data.end() ||
+                (*std::prev(touched)).size() <= (*std::next(touched)).size()) {
+                --neighbour;
+            } else {
+                ++neighbour;
             }
+            touch_bucket(&(*neighbour));
+            auto where = neighbour == std::prev(touched) ?
+                (*neighbour).end() : (*neighbour).begin();
+            (*neighbour).splice(where, *touched);
+            _data.erase(touched);
+            touched = neighbour;
+        }
+        if ((*touched).size() > limit) {
+            auto middle = (*touched).begin();
+            std::advance(middle, (*touched).size() / 2);
+            auto tail = _data.emplace(std::next(touched), std::list<T>());
+            (*tail).splice((*tail).begin(), *touched, middle, (*touched).end());
+        }
+    }
+
+    void rebalance(outer_iterator_t touched) {
+        if (_data.empty()) {
+            return;
+        }
+        if (!_deferred_rebalance && !(_size < _capacity)) {
+            rebalance();
+            return;
+        }
+        if (touched == _data.end()) {
+            --touched;
+        }
+        auto before = touched == _data.begin() ? _data.end() : std::prev(touched);
+        rebalance_local(touched);
+        if (before != _data.end()) {
+            rebalance_local(before);
+        }
+    }
+
+    // mends the seam left by split_at(index) in any mode: the bucket holding
+    // element index and the one before it are folded into a neighbour while
+    // below the target size, or split when oversized, so relinking never
+    // costs a full rebuild
+    void rebalance_around(size_t index) {
+        if (!(index < _size)) {
+            return;
         }
+        seek(index);
+        auto touched = _finger.outer;
+        auto before = touched == _data.begin() ? _data.end() : std::prev(touched);
+        size_t target = target_bucket_size();
+        rebalance_local(touched, target);
+        if (before != _data.end()) {
+            rebalance_local(before, target);
+        }
+    }
+
+    // makes element index the first one of its bucket and returns that
+    // bucket, or _data.end() for index == _size
+    outer_iterator_t split_at(size_t index) {
+        if (index == _size) {
+            return _data.end();
+        }
+        seek(index);
+        auto outer = _finger.outer;
+        auto inner = _finger.inner;
+        drop_finger();
+        if (inner == (*outer).begin()) {
+            return outer;
+        }
+        touch_bucket(&(*outer));
+        auto tail = _data.emplace(std::next(outer), std::list<T>());
+        (*tail).splice((*tail).begin(), *outer, inner, (*outer).end());
+        return tail;
     }
 
     void recalc_size() noexcept {
@@ -503,60 +779,236 @@ class my_vector {
         }
     }
 
-    void add_back(const T& value) noexcept {
-        if (_data.empty()) {
+    size_t balanced_bucket_count() const noexcept {
+        if (_size <= _MAX_FOR_ONE_LIST) {
+            return 1;
+        }
+        return std::max<size_t>(1, _size / target_bucket_size());
+    }
+
+    // replaces the contents with count elements laid out straight into
+    // balanced buckets; fill(bucket, n) appends the next n elements
+    template <class Fill>
+    void build(size_t count, Fill fill) {
+        clear();
+        _size = count;
+        if (count == 0) {
+            return;
+        }
+        size_t buckets = balanced_bucket_count();
+        for (size_t i = 0; i < buckets; ++i) {
             _data.emplace_back(std::list<T>());
+            fill(_data.back(), count / buckets + (i < count % buckets ? 1 : 0));
         }
-        ++_size;
-        _data.back().push_back(value);
+    }
+
+    template <class Iterator>
+    void build_from(Iterator first, Iterator last, std::input_iterator_tag) {
+        std::list<T> all(first, last);
+        build(all.size(), [&all](std::list<T>& bucket, size_t n) {
+            auto end = all.begin();
+            std::advance(end, n);
+            bucket.splice(bucket.end(), all, all.begin(), end);
+        });
+    }
+
+    // large random access ranges: every bucket is filled on its own
+    // thread and the finished buckets are moved into _data
+    template <class Iterator>
+    void build_from(Iterator first, Iterator last, std::random_access_iterator_tag) {
+        size_t count = std::distance(first, last);
+        if (count < _PARALLEL_COPY_THRESHOLD) {
+            build_from(first, last, std::forward_iterator_tag());
+            return;
+        }
+        clear();
+        _size = count;
+        size_t buckets = balanced_bucket_count();
+        _size = 0;
+        std::vector<std::list<T>> parts(buckets);
+        parallel_for(buckets, [&](size_t i) {
+            size_t offset = i * (count / buckets) + std::min(i, count % buckets);
+            size_t n = count / buckets + (i < count % buckets ? 1 : 0);
+            Iterator from = first;
+            std::advance(from, offset);
+            // dereference as const: a mutable my_vector iterator would
+            // drop hash cache entries of the source from every worker
+            const Iterator& source = from;
+            while (n --> 0) {
+                parts[i].push_back(*source);
+                ++from;
+            }
+        });
+        for (auto& part : parts) {
+            _data.emplace_back(std::move(part));
+        }
+        _size = count;
+    }
+
+    template <class Iterator>
+    void build_from(Iterator first, Iterator last, std::forward_iterator_tag) {
+        build(std::distance(first, last), [&first](std::list<T>& bucket, size_t n) {
+            while (n --> 0) {
+                bucket.push_back(*first);
+                ++first;
+            }
+        });
     }
 
     size_t index_by_iterator(const_vector_iterator<T> iter) const {
+        if (iter.outer_iterator == _data.end()) {
+            return _size;
+        }
         size_t index = 0;
-        auto cur = (*this).begin();
-        while (cur.outer_iterator != iter.outer_iterator) {
-            index += ((*cur.outer_iterator).size());
-            ++cur.outer_iterator;
-            cur.inner_iterator = (*cur.outer_iterator).begin();
-            cur.current_element_for_inner = &(*cur.outer_iterator);
-        }
-        while (cur.inner_iterator != iter.inner_iterator) {
-            ++cur.inner_iterator;
+        auto outer = _data.begin();
+        while (outer != iter.outer_iterator) {
+            index += (*outer).size();
+            ++outer;
+        }
+        auto inner = (*outer).begin();
+        while (inner != iter.inner_iterator) {
+            ++inner;
             ++index;
         }
         return index;
     }
 
-    vector_iterator<T> build_iterator(size_t index) {
-        auto outer_it = _data.begin();
-        while ((*outer_it).size() < index && outer_it != _data.end()) {
-            index -= (*outer_it).size();
-            ++outer_it;
+    void drop_finger() noexcept {
+        _finger_valid = false;
+    }
+
+    void touch_bucket(const std::list<T>* bucket) noexcept {
+        if (_element_hash) {
+            _bucket_hashes.erase(bucket);
         }
-        if (outer_it == _data.end()) {
-            throw std::out_of_range("Out of container's bounds");
+    }
+
+    void touch_all() noexcept {
+        _bucket_hashes.clear();
+    }
+
+    template <class Hash>
+    static uint64_t hash_range(const std::list<T>& bucket, Hash hasher, uint64_t& power) {
+        uint64_t result = 0;
+        power = 1;
+        for (const auto& el : bucket) {
+            result = result * _HASH_MULTIPLIER + static_cast<uint64_t>(hasher(el));
+            power *= _HASH_MULTIPLIER;
         }
-        auto inner_it = (*outer_it).begin();
-        while (index --> 0) {
-            ++inner_it;
+        return result;
+    }
+
+    template <class Hash>
+    static size_t element_hash(const T& value) {
+        return Hash()(value);
+    }
+
+    // polynomial hash of the whole sequence, combined from the cached
+    // bucket hashes so it does not depend on the bucket layout; buckets
+    // missing from the cache are hashed but not stored
+    size_t cached_hash() const {
+        uint64_t result = 0;
+        for (const auto& bucket : _data) {
+            auto it = _bucket_hashes.find(&bucket);
+            if (it != _bucket_hashes.end()) {
+                result = result * (*it).second.second + (*it).second.first;
+            } else {
+                uint64_t power;
+                uint64_t hash = hash_range(bucket, _element_hash, power);
+                result = result * power + hash;
+            }
         }
-        return vector_iterator<T>((*this), inner_it, outer_it, (*outer_it));
+        return static_cast<size_t>(result);
     }
 
-    const_vector_iterator<T> build_iterator(size_t index) const {
-        auto outer_it = _data.begin();
-        while ((*outer_it).size() < index && outer_it != _data.end()) {
-            index -= (*outer_it).size();
-            ++outer_it;
+    cursor front_cursor() const {
+        auto& data = const_cast<std::list<std::list<T>>&>(_data);
+        return {data.begin(), (*data.begin()).begin(), 0, 0};
+    }
+
+    cursor back_cursor() const {
+        auto& data = const_cast<std::list<std::list<T>>&>(_data);
+        auto outer = --data.end();
+        size_t start = _size - (*outer).size();
+        return {outer, (*outer).begin(), start, start};
+    }
+
+    // walks c onto element pos, bucket by bucket and then inside the bucket
+    // from whichever of its ends is closer
+    void move_cursor(cursor& c, size_t pos) const {
+        bool moved = false;
+        while (pos < c.start) {
+            --c.outer;
+            c.start -= (*c.outer).size();
+            moved = true;
+        }
+        while (pos >= c.start + (*c.outer).size()) {
+            c.start += (*c.outer).size();
+            ++c.outer;
+            moved = true;
+        }
+        size_t bucket_size = (*c.outer).size();
+        if (moved) {
+            if (pos - c.start < c.start + bucket_size - pos) {
+                c.inner = (*c.outer).begin();
+                c.pos = c.start;
+            } else {
+                c.inner = (*c.outer).end();
+                c.pos = c.start + bucket_size;
+            }
+        }
+        while (c.pos < pos) {
+            ++c.inner;
+            ++c.pos;
         }
-        if (outer_it == _data.end()) {
+        while (c.pos > pos) {
+            --c.inner;
+            --c.pos;
+        }
+    }
+
+    // resolves pos from the nearer end without touching the finger, so
+    // const lookups stay free of shared writes
+    cursor locate(size_t pos) const {
+        if (!(pos < _size)) {
             throw std::out_of_range("Out of container's bounds");
         }
-        auto inner_it = (*outer_it).begin();
-        while (index --> 0) {
-            ++inner_it;
+        cursor result = pos <= _size - pos ? front_cursor() : back_cursor();
+        move_cursor(result, pos);
+        return result;
+    }
+
+    // moves the finger onto element pos, starting from wherever is closest:
+    // the finger itself, the front or the back of the container
+    void seek(size_t pos) {
+        if (!(pos < _size)) {
+            throw std::out_of_range("Out of container's bounds");
+        }
+        size_t from_finger = _finger_valid ?
+            (pos > _finger.pos ? pos - _finger.pos : _finger.pos - pos) : _size;
+        if (pos <= from_finger && pos <= _size - pos) {
+            _finger = front_cursor();
+        } else if (_size - pos < from_finger) {
+            _finger = back_cursor();
         }
-        return const_vector_iterator<T>((*this), inner_it, outer_it, (*outer_it));
+        _finger_valid = true;
+        move_cursor(_finger, pos);
+    }
+
+    vector_iterator<T> build_iterator(size_t index) {
+        if (index == _size) {
+            return end();
+        }
+        seek(index);
+        return vector_iterator<T>((*this), _finger.inner, _finger.outer, (*_finger.outer));
+    }
+
+    const_vector_iterator<T> build_iterator(size_t index) const {
+        if (index == _size) {
+            return end();
+        }
+        cursor c = locate(index);
+        return const_vector_iterator<T>((*this), c.inner, c.outer, (*c.outer));
     }
 
     std::pair<vector_iterator<T>, size_t> get_non_const(const_vector_iterator<T> cpos) {
@@ -566,18 +1018,85 @@ class my_vector {
     }
 
     T& get_element_by_pos(size_t pos) {
-        return (*build_iterator(pos));
+        seek(pos);
+        return (*_finger.inner);
     }
 
     const T& get_element_by_pos(size_t pos) const {
-        return (*build_iterator(pos));
+        return (*locate(pos).inner);
     }
 
     void erase_no_rebalance(const_vector_iterator<T> cpos) {
         auto pos = get_non_const(cpos).first;
+        drop_finger();
+        touch_bucket(pos.current_element_for_inner);
         (*pos.outer_iterator).erase(pos.inner_iterator);
     }
 
+    // (index, slot) pairs ordered by index, so that a batch of lookups can
+    // be answered in a single pass over the buckets
+    template <class IndexRange>
+    std::vector<std::pair<size_t, size_t>> sorted_positions(const IndexRange& indices) const {
+        std::vector<std::pair<size_t, size_t>> order;
+        for (const auto& index : indices) {
+            if (!(static_cast<size_t>(index) < _size)) {
+                throw std::out_of_range("Wrong index");
+            }
+            order.emplace_back(static_cast<size_t>(index), order.size());
+        }
+        std::sort(order.begin(), order.end());
+        return order;
+    }
+
+    template <class Data, class Function>
+    static void sweep(Data& data, const std::vector<std::pair<size_t, size_t>>& order,
+        Function f) {
+        auto outer = data.begin();
+        size_t start = 0;
+        size_t pos = 0;
+        auto inner = (*outer).begin();
+        for (const auto& el : order) {
+            while (el.first >= start + (*outer).size()) {
+                start += (*outer).size();
+                ++outer;
+                inner = (*outer).begin();
+                pos = start;
+            }
+            std::advance(inner, el.first - pos);
+            pos = el.first;
+            f(el.second, *inner);
+        }
+    }
+
+    // calls f on elements first, first + stride, ... below last; whole
+    // buckets that the stride jumps over are skipped by their sizes
+    template <class Function>
+    void walk(size_t first, size_t last, size_t stride, Function f) const {
+        if (!(first < last)) {
+            return;
+        }
+        MY_VECTOR_RECORD(iterate, first, last);
+        cursor c = locate(first);
+        auto outer = c.outer;
+        auto inner = c.inner;
+        size_t left_in_bucket = c.start + (*outer).size() - first;
+        for (size_t pos = first; pos < last; pos += stride) {
+            f(*inner);
+            if (pos + stride >= last) {
+                break;
+            }
+            size_t shift = stride;
+            while (shift >= left_in_bucket) {
+                shift -= left_in_bucket;
+                ++outer;
+                inner = (*outer).begin();
+                left_in_bucket = (*outer).size();
+            }
+            std::advance(inner, shift);
+            left_in_bucket -= shift;
+        }
+    }
+
  public:
     using iterator = vector_iterator<T>;
     using const_iterator = const_vector_iterator<T>;
@@ -589,64 +1108,90 @@ class my_vector {
     };
 
     my_vector(size_t count, const T& value = T()) {
-        while (count --> 0) {
-            add_back(value);
-        }
-        rebalance();
+        _size = 0;
+        assign(count, value);
     }
 
-    template <typename RAIterator>
+    template <typename RAIterator, typename = typename std::enable_if<
+        !std::is_integral<RAIterator>::value>::type>
     my_vector(RAIterator first, RAIterator last) {
-        while (first != last) {
-            add_back(*first);
-            ++first;
-            ++_size;
-        }
-        rebalance();
+        _size = 0;
+        assign(first, last);
     }
 
     my_vector(std::initializer_list<T> ilist)
         : my_vector(ilist.begin(), ilist.end())
     {};
 
-    my_vector(const my_vector& other)
-        : my_vector(other.begin(), other.end())
-    {};
+    // keeps the source layout; large sources are copied bucket by bucket
+    // on all hardware threads
+    my_vector(const my_vector& other) {
+        _size = 0;
+        if (other._size < _PARALLEL_COPY_THRESHOLD) {
+            _data = other._data;
+            _size = other._size;
+            return;
+        }
+        std::vector<const std::list<T>*> sources;
+        for (const auto& bucket : other._data) {
+            sources.push_back(&bucket);
+        }
+        std::vector<std::list<T>> parts(sources.size());
+        parallel_for(sources.size(), [&](size_t i) {
+            parts[i] = *sources[i];
+        });
+        for (auto& part : parts) {
+            _data.emplace_back(std::move(part));
+        }
+        _size = other._size;
+    };
 
     ~my_vector(){};
 
     my_vector& operator=(const my_vector& other) {
         my_vector<T> tmp(other);
+        tmp._element_hash = _element_hash;
         tmp.swap(*this);
         return (*this);
     };
 
     my_vector& operator=(std::initializer_list<T> ilist) {
         my_vector<T> tmp(ilist.begin(), ilist.end());
+        tmp._element_hash = _element_hash;
         tmp.swap(*this);
         return (*this);
     };
 
     my_vector& operator=(my_vector&& other) {
+        drop_finger();
+        other.drop_finger();
         _data = std::move(other._data);
         _size = std::move(other._size);
+        _capacity = other._capacity;
+        if (_element_hash == other._element_hash) {
+            _bucket_hashes = std::move(other._bucket_hashes);
+        } else {
+            _bucket_hashes.clear();
+        }
+        other._bucket_hashes.clear();
         return (*this);
     };
 
     void assign(size_t count, const T& value) {
-        clear();
-        while (count --> 0) {
-            push_back(value);
-        }
-        rebalance();
+        build(count, [&value](std::list<T>& bucket, size_t n) {
+            bucket.insert(bucket.end(), n, value);
+        });
+    };
+
+    template <typename input_iterator, typename = typename std::enable_if<
+        !std::is_integral<input_iterator>::value>::type>
+    void assign(input_iterator first, input_iterator last) {
+        build_from(first, last,
+            typename std::iterator_traits<input_iterator>::iterator_category());
     };
 
     void assign(std::initializer_list<T> ilist) {
-        clear();
-        for (auto& el : ilist) {
-            add_back(el);
-        }
-        rebalance();
+        assign(ilist.begin(), ilist.end());
     };
 
     // element access
@@ -655,21 +1200,33 @@ class my_vector {
         if (!(pos < _size)) {
             throw std::out_of_range("Wrong index");
         }
-        return get_element_by_pos(pos);
+        MY_VECTOR_RECORD(index, pos, 0);
+        note_read();
+        T& result = get_element_by_pos(pos);
+        touch_bucket(&(*_finger.outer));
+        return result;
     };
 
     const T& at(size_t pos) const {
         if (!(pos < _size)) {
             throw std::out_of_range("Wrong index");
         }
+        MY_VECTOR_RECORD(index, pos, 0);
+        note_const_read();
         return get_element_by_pos(pos);
     };
 
     T& operator[](size_t pos) {
-        return get_element_by_pos(pos);
+        MY_VECTOR_RECORD(index, pos, 0);
+        note_read();
+        T& result = get_element_by_pos(pos);
+        touch_bucket(&(*_finger.outer));
+        return result;
     };
 
     const T& operator[](size_t pos) const {
+        MY_VECTOR_RECORD(index, pos, 0);
+        note_const_read();
         return get_element_by_pos(pos);
     };
 
@@ -677,6 +1234,7 @@ class my_vector {
         if (_data.empty() || _data.front().empty()) {
             throw std::out_of_range("Empty container");
         }
+        touch_bucket(&_data.front());
         return _data.front().front();
     };
 
@@ -691,6 +1249,7 @@ class my_vector {
         if (_data.empty() || _data.back().empty()) {
             throw std::out_of_range("Empty container");
         }
+        touch_bucket(&_data.back());
         return _data.back().back();
     };
 
@@ -739,6 +1298,112 @@ class my_vector {
 
     const_iterator crend() const noexcept;
 
+    // batched access: indices are sorted and resolved in one sweep
+
+    template <class IndexRange>
+    my_vector gather(const IndexRange& indices) const {
+        auto order = sorted_positions(indices);
+        std::vector<const T*> found(order.size());
+        if (!order.empty()) {
+            sweep(_data, order, [&found](size_t slot, const T& el) {
+                found[slot] = &el;
+            });
+        }
+        my_vector result;
+        result.set_deferred_rebalance(true);
+        for (auto el : found) {
+            result.push_back(*el);
+        }
+        result.set_deferred_rebalance(false);
+        return result;
+    };
+
+    template <class IndexRange, class ValueRange>
+    void scatter(const IndexRange& indices, const ValueRange& values) {
+        auto order = sorted_positions(indices);
+        // values are copied out first: the range may hold another type or
+        // hand out temporaries that do not outlive the loop
+        std::vector<T> source;
+        for (auto&& el : values) {
+            source.push_back(static_cast<T>(el));
+        }
+        if (source.size() != order.size()) {
+            throw std::invalid_argument("Indices and values differ in length");
+        }
+        touch_all();
+        if (!order.empty()) {
+            sweep(_data, order, [&source](size_t slot, T& el) {
+                el = std::move(source[slot]);
+            });
+        }
+    };
+
+    // hashing
+
+    // keeps a hash per bucket so that hash() only rehashes the buckets
+    // changed since the previous call. A bucket counts as changed when a
+    // reference or iterator into it is handed out, not when it is written,
+    // so writes through references kept across hash() are not seen.
+    // The setting belongs to the vector: copies start without it and
+    // assignment keeps the one of the target
+    template <class Hash = std::hash<T>>
+    void set_hash_cache(bool enabled) {
+        touch_all();
+        _element_hash = enabled ? &element_hash<Hash> : nullptr;
+    };
+
+    bool hash_cache() const noexcept {
+        return _element_hash != nullptr;
+    };
+
+    // hashes the buckets missing from the cache and stores them
+    void refresh_hash_cache() {
+        if (!_element_hash) {
+            return;
+        }
+        for (const auto& bucket : _data) {
+            if (_bucket_hashes.find(&bucket) == _bucket_hashes.end()) {
+                uint64_t power;
+                uint64_t hash = hash_range(bucket, _element_hash, power);
+                _bucket_hashes.emplace(&bucket, std::make_pair(hash, power));
+            }
+        }
+    };
+
+    // the cache is used only when it was enabled with the same Hash
+    template <class Hash = std::hash<T>>
+    size_t hash() {
+        if (_element_hash == &element_hash<Hash>) {
+            refresh_hash_cache();
+        }
+        return static_cast<const my_vector&>(*this).hash<Hash>();
+    };
+
+    template <class Hash = std::hash<T>>
+    size_t hash() const {
+        if (_element_hash == &element_hash<Hash>) {
+            return cached_hash();
+        }
+        uint64_t result = 0;
+        Hash hasher;
+        for (const auto& bucket : _data) {
+            uint64_t power;
+            uint64_t hash = hash_range(bucket, hasher, power);
+            result = result * power + hash;
+        }
+        return static_cast<size_t>(result);
+    };
+
+    // views
+
+    vector_view<T> view() const {
+        return vector_view<T>(*this, 0, _size, 1);
+    };
+
+    vector_view<T> slice(size_t first, size_t last) const {
+        return view().slice(first, last);
+    };
+
     // capacity
 
     bool empty() const noexcept {
@@ -749,9 +1414,61 @@ class my_vector {
         return _size;
     };
 
+    size_t capacity() const noexcept {
+        return std::max(_size, _capacity);
+    };
+
+    void reserve(size_t count) {
+        _capacity = std::max(_capacity, count);
+    };
+
+    // drops the reservation, empty buckets and the spare hash cache slots
+    void shrink_to_fit() {
+        _capacity = 0;
+        drop_finger();
+        for (auto it = _data.begin(); it != _data.end();) {
+            if ((*it).empty() && _data.size() > 1) {
+                touch_bucket(&(*it));
+                it = _data.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (!_data.empty() && !_deferred_rebalance) {
+            rebalance();
+        }
+        _bucket_hashes.rehash(0);
+    };
+
+    struct memory_stats {
+        size_t payload;
+        size_t node_overhead;
+        size_t directory;
+
+        size_t total() const noexcept {
+            return payload + node_overhead + directory;
+        }
+    };
+
+    // bytes held: element values, per-element list links, and everything
+    // that indexes the buckets (bucket headers and the hash cache)
+    memory_stats memory_usage() const noexcept {
+        memory_stats stats;
+        stats.payload = _size * sizeof(T);
+        stats.node_overhead = _size * (list_node_bytes<T>() - sizeof(T));
+        stats.directory = sizeof(*this) +
+            _data.size() * list_node_bytes<std::list<T>>() +
+            _bucket_hashes.size() * list_node_bytes<
+                typename decltype(_bucket_hashes)::value_type>() +
+            _bucket_hashes.bucket_count() * sizeof(void*);
+        return stats;
+    };
+
     // modifiers
 
     void clear() noexcept {
+        drop_finger();
+        touch_all();
         while (!_data.empty()) {
             _data.back().clear();
             _data.pop_back();
@@ -761,9 +1478,13 @@ class my_vector {
 
     iterator insert(iterator pos, const T& value) {
         size_t index = index_by_iterator(pos);
+        MY_VECTOR_RECORD(insert, index, 1);
+        note_write();
+        drop_finger();
+        touch_bucket(&(*pos.outer_iterator));
         (*pos.outer_iterator).insert(pos.inner_iterator, value);
-        rebalance();
         ++_size;
+        rebalance(pos.outer_iterator);
         return build_iterator(index);
     };
 
@@ -771,9 +1492,13 @@ class my_vector {
         auto tmp = get_non_const(cpos);
         vector_iterator<T>& pos = tmp.first;
         size_t index = tmp.second;
+        MY_VECTOR_RECORD(insert, index, 1);
+        note_write();
+        drop_finger();
+        touch_bucket(&(*pos.outer_iterator));
         (*pos.outer_iterator).insert(pos.inner_iterator, value);
-        rebalance();
         ++_size;
+        rebalance(pos.outer_iterator);
         return build_iterator(index);
     };
 
@@ -781,19 +1506,27 @@ class my_vector {
         auto tmp = get_non_const(cpos);
         vector_iterator<T>& pos = tmp.first;
         size_t index = tmp.second;
+        MY_VECTOR_RECORD(insert, index, 1);
+        note_write();
+        drop_finger();
+        touch_bucket(&(*pos.outer_iterator));
         (*pos.outer_iterator).insert(pos.inner_iterator, std::move(value));
-        rebalance();
         ++_size;
+        rebalance(pos.outer_iterator);
         return build_iterator(index);
     };
 
     iterator insert(iterator pos, size_t count, const T& value) {
         size_t index = index_by_iterator(pos);
+        MY_VECTOR_RECORD(insert, index, count);
+        note_write();
+        drop_finger();
+        touch_bucket(&(*pos.outer_iterator));
         while (count --> 0) {
             (*pos.outer_iterator).insert(pos.inner_iterator, value);
             ++_size;
         }
-        rebalance();
+        rebalance(pos.outer_iterator);
         return build_iterator(index);
     };
 
@@ -802,12 +1535,16 @@ class my_vector {
         auto tmp = get_non_const(cpos);
         vector_iterator<T>& pos = tmp.first;
         size_t index = tmp.second;
+        drop_finger();
+        touch_bucket(&(*pos.outer_iterator));
         while (first != last) {
             (*pos.outer_iterator).insert(pos.inner_iterator, (*first));
             ++first;
             ++_size;
         }
-        rebalance();
+        MY_VECTOR_RECORD(insert, index, index_by_iterator(pos) - index);
+        note_write();
+        rebalance(pos.outer_iterator);
         return build_iterator(index);
     };
 
@@ -817,26 +1554,30 @@ class my_vector {
 
     iterator erase(iterator first, iterator last) {
         size_t index = index_by_iterator(first);
+        MY_VECTOR_RECORD(erase, index, index_by_iterator(last) - index);
+        note_write();
+        drop_finger();
+        touch_bucket(first.current_element_for_inner);
         if (first.outer_iterator == last.outer_iterator) {
             (*first.outer_iterator).erase(first.inner_iterator, last.inner_iterator);
         } else {
-            while (first.inner_iterator != (*first.outer_iterator).end()) {
-                first.inner_iterator = (*first.outer_iterator).erase(first.inner_iterator);
+            auto head = first.outer_iterator;
+            (*head).erase(first.inner_iterator, (*head).end());
+            ++first.outer_iterator;
+            if ((*head).empty()) {
+                _data.erase(head);
             }
-            ++first;
             while (first.outer_iterator != last.outer_iterator) {
-                auto prev = first.outer_iterator;
-                ++first.outer_iterator;
-                first.inner_iterator = (*first.outer_iterator).begin();
-                first.current_element_for_inner = &(*first.outer_iterator);
-                _data.erase(prev);
+                touch_bucket(&(*first.outer_iterator));
+                first.outer_iterator = _data.erase(first.outer_iterator);
             }
-            while (first.inner_iterator != last.inner_iterator) {
-                first.inner_iterator = (*first.outer_iterator).erase(first.inner_iterator);
+            if (first.outer_iterator != _data.end()) {
+                touch_bucket(&(*first.outer_iterator));
+                (*first.outer_iterator).erase((*first.outer_iterator).begin(), last.inner_iterator);
             }
         }
         recalc_size();
-        rebalance();
+        rebalance(first.outer_iterator);
         return build_iterator(index);
     };
 
@@ -848,51 +1589,249 @@ class my_vector {
     template <class... Args>
     iterator emplace(const_iterator cpos, Args&&... args) {
         auto pos = get_non_const(cpos);
+        MY_VECTOR_RECORD(insert, pos.second, 1);
+        note_write();
+        drop_finger();
+        touch_bucket(&(*pos.first.outer_iterator));
         (*pos.first.outer_iterator).emplace(pos.first.inner_iterator, args...);
         ++_size;
-        rebalance();
+        rebalance(pos.first.outer_iterator);
         return build_iterator(pos.second);  
     }
 
     template <class... Args>
     void emplace_back(Args&&... args) {
+        MY_VECTOR_RECORD(push_back, 0, 0);
+        touch_bucket(&_data.back());
         _data.back().emplace_back(args...);
         ++_size;
-        rebalance();
+        rebalance(--_data.end());
     }
 
     void push_back(const T& value) {
+        MY_VECTOR_RECORD(push_back, 0, 0);
         if (_data.empty()) {
             _data.emplace_back(std::list<T>());
         }
+        touch_bucket(&_data.back());
         _data.back().push_back(value);
         ++_size;
-        rebalance();
+        rebalance(--_data.end());
     };
 
     void push_back(T&& value) {
+        MY_VECTOR_RECORD(push_back, 0, 0);
         if (_data.empty()) {
             _data.emplace_back(std::list<T>());
         }
+        touch_bucket(&_data.back());
         _data.back().push_back(std::move(value));
         ++_size;
-        rebalance();
+        rebalance(--_data.end());
     };
 
     void pop_back() {
         if (!_data.empty()) {
+            MY_VECTOR_RECORD(pop_back, 0, 0);
+            drop_finger();
+            touch_bucket(&_data.back());
             _data.back().pop_back();
             if (_data.back().empty()) {
                 _data.pop_back();
             }
             --_size;
+            rebalance(_data.end());
+        }
+    };
+
+    // rebalancing
+
+    // bounds for the factor applied to sqrt(n) as the workload shifts;
+    // equal bounds pin the bucket size
+    void set_bucket_scale_bounds(double low, double high) {
+        if (!(low > 0) || !(low <= high)) {
+            throw std::invalid_argument("Wrong bucket scale bounds");
+        }
+        _min_bucket_scale = low;
+        _max_bucket_scale = high;
+        _bucket_scale = std::min(std::max(_bucket_scale, low), high);
+    };
+
+    double bucket_scale() const noexcept {
+        return _bucket_scale;
+    };
+
+    void set_deferred_rebalance(bool deferred) {
+        _deferred_rebalance = deferred;
+        if (!deferred && !_data.empty()) {
             rebalance();
         }
     };
 
+    bool deferred_rebalance() const noexcept {
+        return _deferred_rebalance;
+    };
+
+    // fixes up at most `buckets` buckets, resuming where the previous call
+    // stopped; meant to be called from idle time by the owner of the vector
+    void rebalance_step(size_t buckets = 1) {
+        if (_data.empty()) {
+            return;
+        }
+        if (_rebalance_cursor >= _data.size()) {
+            _rebalance_cursor = 0;
+        }
+        auto it = _data.begin();
+        std::advance(it, _rebalance_cursor);
+        while (buckets --> 0 && it != _data.end()) {
+            size_t before = _data.size();
+            auto next = std::next(it);
+            rebalance_local(it);
+            if (_data.size() >= before) {
+                ++_rebalance_cursor;
+            }
+            it = next;
+        }
+    };
+
+    // reordering: whole buckets are relinked, only the buckets at the
+    // range boundaries are split, and only those are rebalanced afterwards
+
+    iterator rotate(const_iterator middle) {
+        size_t index = index_by_iterator(middle);
+        if (index == 0 || index == _size) {
+            return build_iterator(_size - index);
+        }
+        auto front = split_at(index);
+        _data.splice(_data.end(), _data, _data.begin(), front);
+        rebalance_around(0);
+        rebalance_around(_size - index);
+        rebalance_around(_size - 1);
+        return build_iterator(_size - index);
+    };
+
+    void reverse() {
+        drop_finger();
+        touch_all();
+        _data.reverse();
+        for (auto& bucket : _data) {
+            bucket.reverse();
+        }
+    };
+
+    // moves [first, last) in front of dst, dst must lie outside the range;
+    // returns the new position of the first moved element
+    iterator move_range(const_iterator first, const_iterator last, const_iterator dst) {
+        size_t from = index_by_iterator(first);
+        size_t to = index_by_iterator(last);
+        size_t where = index_by_iterator(dst);
+        if (from > to) {
+            throw std::invalid_argument("Wrong range");
+        }
+        if (from < where && where < to) {
+            throw std::invalid_argument("Destination inside the moved range");
+        }
+        if (where == from || where == to) {
+            return build_iterator(from);
+        }
+        size_t length = to - from;
+        size_t moved_to = where < from ? where : where - length;
+        if (length == 0) {
+            return build_iterator(moved_to);
+        }
+        auto range_begin = split_at(from);
+        auto range_end = split_at(to);
+        auto target = split_at(where);
+        _data.splice(target, _data, range_begin, range_end);
+        if (where < from) {
+            rebalance_around(where);
+            rebalance_around(where + length);
+            rebalance_around(to);
+        } else {
+            rebalance_around(from);
+            rebalance_around(moved_to);
+            rebalance_around(where);
+        }
+        return build_iterator(moved_to);
+    };
+
+    // sorts every bucket on its own thread, then k-way merges the buckets
+    // into a balanced layout; elements are relinked, never copied or moved
+    template <class Compare = std::less<T>>
+    void stable_sort(Compare comp = Compare()) {
+        if (_data.empty()) {
+            return;
+        }
+        drop_finger();
+        touch_all();
+        std::vector<std::list<T>*> buckets;
+        for (auto& bucket : _data) {
+            buckets.push_back(&bucket);
+        }
+        parallel_for(buckets.size(), [&](size_t i) {
+            buckets[i]->sort(comp);
+        });
+        if (buckets.size() == 1) {
+            return;
+        }
+
+        using head = std::pair<std::list<T>*, size_t>;
+        auto later = [&comp](const head& a, const head& b) {
+            if (comp(b.first->front(), a.first->front())) {
+                return true;
+            }
+            return !comp(a.first->front(), b.first->front()) && a.second > b.second;
+        };
+        std::priority_queue<head, std::vector<head>, decltype(later)> heads(later);
+        for (size_t i = 0; i < buckets.size(); ++i) {
+            if (!buckets[i]->empty()) {
+                heads.push({buckets[i], i});
+            }
+        }
+
+        // the merged buckets are built in front of the sorted ones inside
+        // _data, so a throwing comp leaves every element in the container
+        size_t bucket_count = balanced_bucket_count();
+        size_t bigger_buckets = _size % bucket_count;
+        auto sorted = _data.begin();
+        auto out = _data.end();
+        size_t merged = 0;
+        try {
+            while (!heads.empty()) {
+                if (out == _data.end() || (*out).size() == _size / bucket_count +
+                    (merged <= bigger_buckets ? 1 : 0)) {
+                    out = _data.emplace(sorted, std::list<T>());
+                    ++merged;
+                }
+                head top = heads.top();
+                heads.pop();
+                (*out).splice((*out).end(), *top.first, top.first->begin());
+                if (!top.first->empty()) {
+                    heads.push(top);
+                }
+            }
+        } catch (...) {
+            for (auto it = _data.begin(); it != _data.end();) {
+                it = (*it).empty() ? _data.erase(it) : std::next(it);
+            }
+            throw;
+        }
+        _data.erase(sorted, _data.end());
+    }
+
+    template <class Compare = std::less<T>>
+    void sort(Compare comp = Compare()) {
+        stable_sort(comp);
+    }
+
     void swap(my_vector& other) {
+        drop_finger();
+        other.drop_finger();
         std::swap(_data, other._data);
         std::swap(_size, other._size);
+        std::swap(_capacity, other._capacity);
+        std::swap(_bucket_hashes, other._bucket_hashes);
+        std::swap(_element_hash, other._element_hash);
     };
 };
 
@@ -901,8 +1840,10 @@ bool operator==(my_vector<T>& first, my_vector<T>& second) {
     if (first.size() != second.size()) {
         return false;
     }
-    auto it1 = first.begin(), it2 = second.begin();
-    while (it1 != first.end()) {
+    const my_vector<T>& cfirst = first;
+    const my_vector<T>& csecond = second;
+    auto it1 = cfirst.begin(), it2 = csecond.begin();
+    while (it1 != cfirst.end()) {
         if ((*it1) != (*it2)) {
             return false;
         }
@@ -956,3 +1897,144 @@ void swap(my_vector<T>& left, my_vector<T>& right) {
     left.swap(right);
 }
 
+namespace std {
+template <class T>
+struct hash<my_vector<T>> {
+    size_t operator()(const my_vector<T>& value) const {
+        return value.hash();
+    }
+};
+}
+
+// lazy views: nothing is copied until collect(), every stage hands elements
+// to the next one while walking the buckets once
+
+template <class Derived, class Value>
+class view_adaptors;
+
+template <class Base, class Predicate>
+class filter_view;
+
+template <class Base, class Function>
+class transform_view;
+
+template <class Derived, class Value>
+class view_adaptors {
+ public:
+    using value_type = Value;
+
+    template <class Predicate>
+    filter_view<Derived, Predicate> filter(Predicate pred) const {
+        return filter_view<Derived, Predicate>(static_cast<const Derived&>(*this), pred);
+    }
+
+    template <class Function>
+    transform_view<Derived, Function> transform(Function f) const {
+        return transform_view<Derived, Function>(static_cast<const Derived&>(*this), f);
+    }
+
+    my_vector<Value> collect() const {
+        my_vector<Value> result;
+        result.set_deferred_rebalance(true);
+        static_cast<const Derived&>(*this).for_each([&result](const Value& value) {
+            result.push_back(value);
+        });
+        result.set_deferred_rebalance(false);
+        return result;
+    }
+};
+
+template <class T>
+class vector_view: public view_adaptors<vector_view<T>, T> {
+    using size_t = std::size_t;
+ private:
+    const my_vector<T>* _vector;
+    size_t _first;
+    size_t _last;
+    size_t _stride;
+
+ public:
+    vector_view(const my_vector<T>& vector, size_t first, size_t last, size_t stride)
+        : _vector(&vector)
+        , _first(first)
+        , _last(std::min(last, vector.size()))
+        , _stride(stride)
+    {}
+
+    size_t size() const noexcept {
+        return _first < _last ? (_last - _first + _stride - 1) / _stride : 0;
+    }
+
+    const T& operator[](size_t pos) const {
+        return (*_vector)[_first + pos * _stride];
+    }
+
+    vector_view slice(size_t first, size_t last) const {
+        last = std::min(last, size());
+        first = std::min(first, last);
+        if (first == last) {
+            return vector_view(*_vector, _first, _first, _stride);
+        }
+        return vector_view(*_vector, _first + first * _stride,
+            _first + (last - 1) * _stride + 1, _stride);
+    }
+
+    vector_view stride(size_t step) const {
+        if (step == 0) {
+            throw std::invalid_argument("Zero stride");
+        }
+        return vector_view(*_vector, _first, _last, _stride * step);
+    }
+
+    template <class Function>
+    void for_each(Function f) const {
+        _vector->walk(_first, _last, _stride, f);
+    }
+};
+
+template <class Base, class Predicate>
+class filter_view: public view_adaptors<filter_view<Base, Predicate>,
+    typename Base::value_type> {
+ private:
+    Base _base;
+    Predicate _pred;
+
+ public:
+    filter_view(const Base& base, Predicate pred)
+        : _base(base)
+        , _pred(pred)
+    {}
+
+    template <class Function>
+    void for_each(Function f) const {
+        const Predicate& pred = _pred;
+        _base.for_each([&pred, &f](const typename Base::value_type& value) {
+            if (pred(value)) {
+                f(value);
+            }
+        });
+    }
+};
+
+template <class Base, class Function>
+class transform_view: public view_adaptors<transform_view<Base, Function>,
+    typename std::decay<decltype(std::declval<const Function&>()(
+        std::declval<const typename Base::value_type&>()))>::type> {
+ private:
+    Base _base;
+    Function _func;
+
+ public:
+    transform_view(const Base& base, Function func)
+        : _base(base)
+        , _func(func)
+    {}
+
+    template <class Consumer>
+    void for_each(Consumer f) const {
+        const Function& func = _func;
+        _base.for_each([&func, &f](const typename Base::value_type& value) {
+            f(func(value));
+        });
+    }
+};
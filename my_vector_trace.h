@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <istream>
+#include <mutex>
+#include <ostream>
+
+// operation trace of my_vector, compiled in with -DMY_VECTOR_TRACE.
+// Every record is an op byte followed by three varints: the id of the
+// vector, then two operands (index and count where they apply).
+// The counters and the sink are process-wide; record() serializes on a
+// mutex, so read counter() or swap sink() only while nothing records.
+namespace my_vector_trace {
+
+enum op : uint8_t {
+    push_back,
+    pop_back,
+    insert,
+    erase,
+    index,
+    iterate,
+    rebalance,
+    op_count
+};
+
+struct event {
+    op code;
+    uint64_t id;
+    uint64_t a;
+    uint64_t b;
+};
+
+inline const char* name(op code) {
+    static const char* names[op_count] = {
+        "push_back", "pop_back", "insert", "erase", "index", "iterate", "rebalance"
+    };
+    return code < op_count ? names[code] : "unknown";
+}
+
+inline std::ostream*& sink() {
+    static std::ostream* out = nullptr;
+    return out;
+}
+
+inline uint64_t& counter(op code) {
+    static uint64_t counts[op_count] = {};
+    return counts[code];
+}
+
+inline uint64_t next_id() {
+    static std::atomic<uint64_t> id{0};
+    return id++;
+}
+
+inline std::mutex& lock() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+inline void write_varint(std::ostream& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.put(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.put(static_cast<char>(value));
+}
+
+inline bool read_varint(std::istream& in, uint64_t& value) {
+    value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        int byte = in.get();
+        if (byte == std::istream::traits_type::eof()) {
+            return false;
+        }
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline void record(uint64_t id, op code, uint64_t a, uint64_t b) {
+    std::lock_guard<std::mutex> guard(lock());
+    ++counter(code);
+    std::ostream* out = sink();
+    if (out) {
+        out->put(static_cast<char>(code));
+        write_varint(*out, id);
+        write_varint(*out, a);
+        write_varint(*out, b);
+    }
+}
+
+inline bool read(std::istream& in, event& result) {
+    int code = in.get();
+    if (code == std::istream::traits_type::eof() || code >= op_count) {
+        return false;
+    }
+    result.code = static_cast<op>(code);
+    return read_varint(in, result.id) && read_varint(in, result.a) &&
+        read_varint(in, result.b);
+}
+
+}  // namespace my_vector_trace
@@ -0,0 +1,376 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "my_vector.h"
+
+// read-mostly storage for integer ids: every bucket holds zigzag varint
+// deltas between neighbouring values and is decoded only when touched;
+// buckets are found by binary search over their starting positions.
+// Full buckets may switch to frame-of-reference bit-packing (offsets from
+// the bucket minimum in a fixed bit width), see set_packing(): it reads
+// any element directly and unpacks in a loop without carried state
+template <class T>
+class packed_vector {
+ public:
+    // layout of full buckets: the smaller of the two, always varint, or
+    // always frame of reference (random reads in O(1))
+    enum class packing {
+        smallest,
+        varint,
+        frame
+    };
+
+ private:
+    static_assert(std::is_integral<T>::value && !std::is_same<T, bool>::value,
+        "packed_vector stores integers only");
+    using size_t = std::size_t;
+    using unsigned_t = typename std::make_unsigned<T>::type;
+    using signed_t = typename std::make_signed<T>::type;
+
+    struct bucket {
+        size_t count = 0;
+        unsigned_t last = 0;
+        std::vector<uint8_t> bytes;
+        // frame of reference: count offsets from base, width bits each,
+        // plus one spare word so that unpacking never reads past the end
+        bool packed = false;
+        unsigned width = 0;
+        unsigned_t base = 0;
+        std::vector<uint64_t> words;
+    };
+
+ private:
+    std::vector<bucket> _data;
+    std::vector<size_t> _starts;
+    size_t _size;
+    packing _packing = packing::smallest;
+    static const size_t _BUCKET_SIZE = 128;
+
+    static unsigned_t zigzag(unsigned_t delta) noexcept {
+        signed_t value = static_cast<signed_t>(delta);
+        return (static_cast<unsigned_t>(value) << 1) ^
+            static_cast<unsigned_t>(value >> (sizeof(T) * 8 - 1));
+    }
+
+    static unsigned_t unzigzag(unsigned_t value) noexcept {
+        return (value >> 1) ^ (~(value & 1) + 1);
+    }
+
+    // appends one value as the delta from the last value of the bucket
+    static void append(bucket& out, T value) {
+        unsigned_t rest = zigzag(static_cast<unsigned_t>(value) - out.last);
+        out.last = static_cast<unsigned_t>(value);
+        ++out.count;
+        while (rest >= 0x80) {
+            out.bytes.push_back(static_cast<uint8_t>(rest | 0x80));
+            rest >>= 7;
+        }
+        out.bytes.push_back(static_cast<uint8_t>(rest));
+    }
+
+    static void pack(const std::vector<T>& values, bucket& out) {
+        out.base = static_cast<unsigned_t>(*std::min_element(values.begin(), values.end()));
+        unsigned_t range = static_cast<unsigned_t>(*std::max_element(values.begin(), values.end())) - out.base;
+        out.width = 0;
+        while (out.width < sizeof(T) * 8 && (range >> out.width) != 0) {
+            ++out.width;
+        }
+        out.words.assign(values.size() * out.width / 64 + 2, 0);
+        for (size_t i = 0; i < values.size(); ++i) {
+            uint64_t offset = static_cast<unsigned_t>(static_cast<unsigned_t>(values[i]) - out.base);
+            size_t bit = i * out.width;
+            unsigned shift = bit & 63;
+            out.words[bit >> 6] |= offset << shift;
+            if (shift + out.width > 64) {
+                out.words[(bit >> 6) + 1] |= offset >> (64 - shift);
+            }
+        }
+        out.packed = true;
+    }
+
+    // buckets below _BUCKET_SIZE stay varint so push_back can append to
+    // them; fuller ones take the layout chosen by _packing
+    void encode(const std::vector<T>& values, bucket& out) const {
+        out.count = 0;
+        out.last = 0;
+        out.bytes.clear();
+        out.packed = false;
+        out.words.clear();
+        for (const auto& el : values) {
+            append(out, el);
+        }
+        if (values.size() >= _BUCKET_SIZE && _packing != packing::varint) {
+            bucket frame;
+            pack(values, frame);
+            if (_packing == packing::frame ||
+                frame.words.size() * sizeof(uint64_t) <= out.bytes.size()) {
+                out.packed = true;
+                out.width = frame.width;
+                out.base = frame.base;
+                out.words.swap(frame.words);
+                out.bytes.clear();
+            }
+        }
+        out.bytes.shrink_to_fit();
+    }
+
+    static uint64_t width_mask(unsigned width) noexcept {
+        return width >= 64 ? ~uint64_t(0) : (uint64_t(1) << width) - 1;
+    }
+
+    // value i of a packed bucket; the high part comes from the next word,
+    // shifted in two steps so that a zero shift stays defined
+    static unsigned_t extract(const bucket& in, size_t i) noexcept {
+        size_t bit = i * in.width;
+        unsigned shift = bit & 63;
+        const uint64_t* word = in.words.data() + (bit >> 6);
+        uint64_t value = (word[0] >> shift) | ((word[1] << 1) << (63 - shift));
+        return in.base + static_cast<unsigned_t>(value & width_mask(in.width));
+    }
+
+    // branch-free and without loop-carried state, so the compiler may
+    // vectorize it (gathers on AVX2 and later)
+    static void unpack(const bucket& in, size_t limit, unsigned_t* out) noexcept {
+        const uint64_t* words = in.words.data();
+        const unsigned width = in.width;
+        const uint64_t mask = width_mask(width);
+        const unsigned_t base = in.base;
+        for (size_t i = 0; i < limit; ++i) {
+            size_t bit = i * width;
+            unsigned shift = bit & 63;
+            uint64_t value = (words[bit >> 6] >> shift) |
+                ((words[(bit >> 6) + 1] << 1) << (63 - shift));
+            out[i] = base + static_cast<unsigned_t>(value & mask);
+        }
+    }
+
+    // calls f on the first `limit` values of the bucket, in order
+    template <class Function>
+    static void decode(const bucket& in, size_t limit, Function f) {
+        if (in.packed) {
+            unsigned_t values[2 * _BUCKET_SIZE];
+            unpack(in, limit, values);
+            for (size_t i = 0; i < limit; ++i) {
+                f(static_cast<T>(values[i]));
+            }
+            return;
+        }
+        unsigned_t prev = 0;
+        const uint8_t* cur = in.bytes.data();
+        for (size_t i = 0; i < limit; ++i) {
+            unsigned_t value = 0;
+            unsigned shift = 0;
+            while ((*cur) & 0x80) {
+                value |= static_cast<unsigned_t>(*cur & 0x7f) << shift;
+                shift += 7;
+                ++cur;
+            }
+            value |= static_cast<unsigned_t>(*cur) << shift;
+            ++cur;
+            prev += unzigzag(value);
+            f(static_cast<T>(prev));
+        }
+    }
+
+    static std::vector<T> decode(const bucket& in) {
+        std::vector<T> values;
+        values.reserve(in.count);
+        decode(in, in.count, [&values](T value) {
+            values.push_back(value);
+        });
+        return values;
+    }
+
+    // finds the bucket holding pos and turns pos into an offset inside it;
+    // returns _data.size() when pos is out of range
+    size_t find_bucket(size_t& pos) const {
+        if (!(pos < _size)) {
+            return _data.size();
+        }
+        size_t index = std::upper_bound(_starts.begin(), _starts.end(), pos) - _starts.begin() - 1;
+        pos -= _starts[index];
+        return index;
+    }
+
+    // recomputes the starting positions of the buckets from index on
+    void reindex(size_t index) {
+        for (size_t i = index; i < _data.size(); ++i) {
+            _starts[i] = i == 0 ? 0 : _starts[i - 1] + _data[i - 1].count;
+        }
+    }
+
+    void store(size_t index, std::vector<T>& values) {
+        if (values.empty()) {
+            _data.erase(_data.begin() + index);
+            _starts.erase(_starts.begin() + index);
+        } else {
+            if (values.size() > 2 * _BUCKET_SIZE) {
+                std::vector<T> tail(values.begin() + _BUCKET_SIZE, values.end());
+                values.resize(_BUCKET_SIZE);
+                _data.insert(_data.begin() + index + 1, bucket());
+                _starts.insert(_starts.begin() + index + 1, 0);
+                encode(tail, _data[index + 1]);
+            }
+            encode(values, _data[index]);
+        }
+        reindex(index);
+    }
+
+ public:
+    packed_vector() {
+        _size = 0;
+    };
+
+    template <class input_iterator>
+    packed_vector(input_iterator first, input_iterator last) {
+        _size = 0;
+        while (first != last) {
+            push_back(*first);
+            ++first;
+        }
+    }
+
+    explicit packed_vector(const my_vector<T>& other)
+        : packed_vector(other.begin(), other.end())
+    {};
+
+    // element access
+
+    T at(size_t pos) const {
+        if (!(pos < _size)) {
+            throw std::out_of_range("Wrong index");
+        }
+        return (*this)[pos];
+    };
+
+    T operator[](size_t pos) const {
+        size_t index = find_bucket(pos);
+        if (index == _data.size()) {
+            throw std::out_of_range("Out of container's bounds");
+        }
+        if (_data[index].packed) {
+            return static_cast<T>(extract(_data[index], pos));
+        }
+        T result = T();
+        decode(_data[index], pos + 1, [&result](T value) {
+            result = value;
+        });
+        return result;
+    };
+
+    template <class Function>
+    void for_each(Function f) const {
+        for (const auto& el : _data) {
+            decode(el, el.count, f);
+        }
+    }
+
+    my_vector<T> unpack() const {
+        my_vector<T> result;
+        for_each([&result](T value) {
+            result.push_back(value);
+        });
+        return result;
+    }
+
+    // capacity
+
+    bool empty() const noexcept {
+        return _size == 0;
+    };
+
+    size_t size() const noexcept {
+        return _size;
+    };
+
+    size_t encoded_bytes() const noexcept {
+        size_t bytes = 0;
+        for (const auto& el : _data) {
+            bytes += el.bytes.capacity() + el.words.capacity() * sizeof(uint64_t);
+        }
+        return bytes;
+    };
+
+    packing bucket_packing() const noexcept {
+        return _packing;
+    };
+
+    // re-encodes every full bucket in the new layout
+    void set_packing(packing mode) {
+        _packing = mode;
+        for (auto& el : _data) {
+            if (el.count >= _BUCKET_SIZE) {
+                encode(decode(el), el);
+            }
+        }
+    };
+
+    // modifiers; each one re-encodes at most a single bucket
+
+    void set(size_t pos, T value) {
+        size_t index = find_bucket(pos);
+        if (index == _data.size()) {
+            throw std::out_of_range("Out of container's bounds");
+        }
+        auto values = decode(_data[index]);
+        values[pos] = value;
+        encode(values, _data[index]);
+    };
+
+    void insert(size_t pos, T value) {
+        if (pos > _size) {
+            throw std::out_of_range("Out of container's bounds");
+        }
+        if (pos == _size) {
+            push_back(value);
+            return;
+        }
+        size_t index = find_bucket(pos);
+        auto values = decode(_data[index]);
+        values.insert(values.begin() + pos, value);
+        ++_size;
+        store(index, values);
+    };
+
+    void erase(size_t pos) {
+        size_t index = find_bucket(pos);
+        if (index == _data.size()) {
+            throw std::out_of_range("Out of container's bounds");
+        }
+        auto values = decode(_data[index]);
+        values.erase(values.begin() + pos);
+        --_size;
+        store(index, values);
+    };
+
+    // appends the varint to the tail bucket, which is re-encoded once full
+    void push_back(T value) {
+        if (_data.empty() || _data.back().count >= _BUCKET_SIZE) {
+            _data.emplace_back();
+            _starts.push_back(_size);
+        }
+        append(_data.back(), value);
+        ++_size;
+        if (_data.back().count == _BUCKET_SIZE) {
+            encode(decode(_data.back()), _data.back());
+        }
+    };
+
+    void clear() noexcept {
+        _data.clear();
+        _starts.clear();
+        _size = 0;
+    };
+
+    void swap(packed_vector& other) {
+        std::swap(_data, other._data);
+        std::swap(_starts, other._starts);
+        std::swap(_size, other._size);
+        std::swap(_packing, other._packing);
+    };
+};
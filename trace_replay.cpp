@@ -0,0 +1,143 @@
+// Replays a my_vector operation trace against my_vector, std::vector and
+// std::deque and reports the time spent per operation class.
+//
+//     g++ -std=c++14 -O2 -pthread trace_replay.cpp -o trace_replay
+//     ./trace_replay trace.bin
+//
+// Traces are written by code built with -DMY_VECTOR_TRACE after pointing
+// my_vector_trace::sink() at a binary std::ostream.
+
+#define MY_VECTOR_TRACE
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include "my_vector.h"
+
+namespace {
+
+using trace = std::vector<my_vector_trace::event>;
+using value_type = int64_t;
+
+struct report {
+    double seconds[my_vector_trace::op_count] = {};
+    uint64_t calls[my_vector_trace::op_count] = {};
+};
+
+template <class Container>
+value_type replay_one(Container& c, const my_vector_trace::event& ev) {
+    value_type checksum = 0;
+    switch (ev.code) {
+    case my_vector_trace::push_back:
+        c.push_back(static_cast<value_type>(ev.id));
+        break;
+    case my_vector_trace::pop_back:
+        if (!c.empty()) {
+            c.pop_back();
+        }
+        break;
+    case my_vector_trace::insert:
+        if (ev.a >= c.size()) {
+            for (uint64_t i = 0; i < ev.b; ++i) {
+                c.push_back(static_cast<value_type>(ev.a));
+            }
+        } else {
+            c.insert(c.begin() + ev.a, static_cast<size_t>(ev.b), static_cast<value_type>(ev.a));
+        }
+        break;
+    case my_vector_trace::erase:
+        if (ev.a < c.size() && ev.b != 0) {
+            size_t last = static_cast<size_t>(std::min<uint64_t>(ev.a + ev.b, c.size()));
+            c.erase(c.begin() + ev.a, c.begin() + last);
+        }
+        break;
+    case my_vector_trace::index:
+        if (ev.a < c.size()) {
+            checksum += c[ev.a];
+        }
+        break;
+    case my_vector_trace::iterate:
+        if (ev.a < c.size()) {
+            size_t last = static_cast<size_t>(std::min<uint64_t>(ev.b, c.size()));
+            for (auto it = c.begin() + ev.a, stop = c.begin() + last; it != stop; ++it) {
+                checksum += *it;
+            }
+        }
+        break;
+    default:
+        break;
+    }
+    return checksum;
+}
+
+template <class Container>
+report replay(const trace& events) {
+    report result;
+    std::map<uint64_t, Container> containers;
+    value_type checksum = 0;
+    for (const auto& ev : events) {
+        if (ev.code == my_vector_trace::rebalance) {
+            continue;
+        }
+        Container& c = containers[ev.id];
+        auto start = std::chrono::steady_clock::now();
+        checksum += replay_one(c, ev);
+        auto finish = std::chrono::steady_clock::now();
+        result.seconds[ev.code] += std::chrono::duration<double>(finish - start).count();
+        ++result.calls[ev.code];
+    }
+    volatile value_type keep = checksum;
+    (void)keep;
+    return result;
+}
+
+void print(const char* name, const report& r) {
+    std::cout << name << '\n';
+    for (int code = 0; code < my_vector_trace::rebalance; ++code) {
+        if (r.calls[code] == 0) {
+            continue;
+        }
+        std::cout << "  " << std::setw(10) << my_vector_trace::name(static_cast<my_vector_trace::op>(code))
+            << std::setw(12) << r.calls[code] << " calls"
+            << std::setw(14) << std::fixed << std::setprecision(6) << r.seconds[code] << " s"
+            << std::setw(12) << std::setprecision(1) << 1e9 * r.seconds[code] / r.calls[code] << " ns/op\n";
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        std::cerr << "usage: " << argv[0] << " <trace file>\n";
+        return 2;
+    }
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in) {
+        std::cerr << "cannot open " << argv[1] << '\n';
+        return 1;
+    }
+    trace events;
+    uint64_t recorded_rebalances = 0;
+    my_vector_trace::event ev;
+    while (my_vector_trace::read(in, ev)) {
+        if (ev.code == my_vector_trace::rebalance) {
+            ++recorded_rebalances;
+        }
+        events.push_back(ev);
+    }
+    std::cout << events.size() << " events, " << recorded_rebalances
+        << " rebalances while recording\n";
+
+    uint64_t before = my_vector_trace::counter(my_vector_trace::rebalance);
+    print("my_vector", replay<my_vector<value_type>>(events));
+    std::cout << "  rebalances " << my_vector_trace::counter(my_vector_trace::rebalance) - before << '\n';
+    print("std::vector", replay<std::vector<value_type>>(events));
+    print("std::deque", replay<std::deque<value_type>>(events));
+    return 0;
+}